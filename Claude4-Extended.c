@@ -1,125 +1,345 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Parallel loops use OpenMP when built with -fopenmp and run sequentially
+// otherwise. Declare in tc.h alongside tc_fast:
+UINT_t tc_fast_deterministic(const GRAPH_TYPE *graph, UINT_t *vertex_tri, UINT_t *edge_tri);
+
+// Unsigned 128-bit accumulator used for the final reduction. Kept as two
+// 64-bit words so it does not depend on compiler __int128 support.
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} tc_u128_t;
+
+// Counts are audited, so a wrapped value is never returned
+static void tc_overflow(const char *what) {
+    fprintf(stderr, "ERROR: %s overflowed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+static inline void tc_u128_add(tc_u128_t *acc, uint64_t x) {
+    const uint64_t lo = acc->lo + x;
+    if (lo < x) {
+        if (acc->hi == UINT64_MAX) tc_overflow("128-bit triangle accumulator");
+        acc->hi++;
+    }
+    acc->lo = lo;
+}
+
+static inline void tc_u128_add_u128(tc_u128_t *acc, tc_u128_t x) {
+    tc_u128_add(acc, x.lo);
+    if (x.hi > UINT64_MAX - acc->hi) tc_overflow("128-bit triangle accumulator");
+    acc->hi += x.hi;
+}
+
+// x / 3 without 128-bit arithmetic, using 2^64 = 3 * ((2^64 - 1) / 3) + 1
+static inline tc_u128_t tc_u128_div3(tc_u128_t x) {
+    const uint64_t hi_r = x.hi % 3;
+    tc_u128_t q;
+    q.hi = x.hi / 3;
+    q.lo = hi_r * (UINT64_MAX / 3) + x.lo / 3 + (hi_r + x.lo % 3) / 3;
+    return q;
+}
+
+// 64-bit per-thread partial counter; spills into a 128-bit word on wraparound
+// instead of silently losing the carry.
+static inline void tc_partial_add(uint64_t *partial, tc_u128_t *spill, uint64_t x) {
+    if (x > UINT64_MAX - *partial) {
+        tc_u128_add(spill, *partial);
+        *partial = 0;
+    }
+    *partial += x;
+}
+
+// Narrow a count to UINT_t, refusing to return a wrapped value
+static inline UINT_t tc_u128_to_uint(tc_u128_t x, const char *what) {
+    if (x.hi != 0 || x.lo > (uint64_t)(UINT_t)-1) tc_overflow(what);
+    return (UINT_t)x.lo;
+}
+
+static inline int tc_num_threads(void) {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static inline int tc_thread_id(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#ifndef TC_DETERMINISTIC
+static int tc_compare_uint(const void *a, const void *b) {
+    const UINT_t x = *(const UINT_t *)a;
+    const UINT_t y = *(const UINT_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sort any adjacency list that is not already ascending. The forward kernel
+// relies on lower neighbors forming a prefix of each list, which
+// reorder_graph_by_degree does not promise.
+static void tc_sort_rows(GRAPH_TYPE *graph) {
+    const UINT_t n = graph->numVertices;
+    const UINT_t* restrict Ap = graph->rowPtr;
+    UINT_t* restrict Ai = graph->colInd;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (UINT_t v = 0; v < n; v++) {
+        for (UINT_t p = Ap[v] + 1; p < Ap[v + 1]; p++) {
+            if (Ai[p - 1] > Ai[p]) {
+                qsort(&Ai[Ap[v]], Ap[v + 1] - Ap[v], sizeof(UINT_t), tc_compare_uint);
+                break;
+            }
+        }
+    }
+}
+
+// Forward algorithm over a degree-ordered graph with sorted rows. For each
+// edge (s,t) with s < t, the triangles {w,s,t} with w < s are the common
+// neighbors of s and t below s. Those are prefixes of N(s) and N(t), so no
+// shared forward-list state is needed between vertices, which lets each
+// thread take whole source vertices independently.
+static tc_u128_t tc_forward_parallel(const GRAPH_TYPE *graph) {
+    const UINT_t n = graph->numVertices;
+    const UINT_t* restrict Ap = graph->rowPtr;
+    const UINT_t* restrict Ai = graph->colInd;
+
+    const int nthreads = tc_num_threads();
+    tc_u128_t* restrict partials = (tc_u128_t*)calloc(nthreads, sizeof(tc_u128_t));
+    assert_malloc(partials);
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        bool* restrict Hash = (bool*)calloc(n, sizeof(bool));
+        assert_malloc(Hash);
+
+        uint64_t count = 0;
+        tc_u128_t spill = {0, 0};
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (UINT_t s = 0; s < n; s++) {
+            const UINT_t s_start = Ap[s];
+            const UINT_t s_end = Ap[s + 1];
+
+            // Hash the lower neighbors of s
+            UINT_t s_low = s_start;
+            while (s_low < s_end && Ai[s_low] < s)
+                Hash[Ai[s_low++]] = true;
+
+            if (s_low > s_start) {
+                for (UINT_t i = s_low; i < s_end; i++) {
+                    const UINT_t t = Ai[i];
+                    if (t <= s) continue;
+
+                    // Probe t's neighbors below s against the hash
+                    uint64_t hits = 0;
+                    for (UINT_t j = Ap[t]; j < Ap[t + 1] && Ai[j] < s; j++)
+                        hits += Hash[Ai[j]];
+                    tc_partial_add(&count, &spill, hits);
+                }
+            }
+
+            // Clear hash table
+            for (UINT_t i = s_start; i < s_low; i++)
+                Hash[Ai[i]] = false;
+        }
+
+        tc_u128_add(&spill, count);
+        partials[tc_thread_id()] = spill;
+        free(Hash);
+    }
+
+    tc_u128_t total = {0, 0};
+    for (int i = 0; i < nthreads; i++)
+        tc_u128_add_u128(&total, partials[i]);
+
+    free(partials);
+    return total;
+}
+#endif
+
 UINT_t tc_fast(const GRAPH_TYPE *graph) {
+#ifdef TC_DETERMINISTIC
+    return tc_fast_deterministic(graph, NULL, NULL);
+#else
     const UINT_t n = graph->numVertices;
-    const UINT_t m = graph->numEdges;
-    
+
     // For very small graphs, use Tim Davis's optimized algorithm directly
     if (n < 100) {
         const UINT_t* restrict Ap = graph->rowPtr;
         const UINT_t* restrict Ai = graph->colInd;
-        
+
         bool* restrict Mark = (bool*)calloc(n, sizeof(bool));
         assert_malloc(Mark);
-        
-        UINT_t ntri = 0;
+
+        // Count each triangle j < k < x exactly once rather than summing all
+        // six wedge hits and dividing, so the running sum never exceeds the
+        // result.
+        uint64_t ntri = 0;
+        tc_u128_t spill = {0, 0};
         for (UINT_t j = 0; j < n; j++) {
             const UINT_t j_start = Ap[j];
             const UINT_t j_end = Ap[j + 1];
-            
-            // Mark all neighbors of j
+
+            // Mark higher neighbors of j
             for (UINT_t p = j_start; p < j_end; p++)
-                Mark[Ai[p]] = true;
-            
-            // Count triangles through common neighbors
+                if (Ai[p] > j) Mark[Ai[p]] = true;
+
+            // Count triangles through common higher neighbors
             for (UINT_t p = j_start; p < j_end; p++) {
                 const UINT_t k = Ai[p];
+                if (k <= j) continue;
                 const UINT_t k_start = Ap[k];
                 const UINT_t k_end = Ap[k + 1];
-                
+
+                uint64_t hits = 0;
                 for (UINT_t pa = k_start; pa < k_end; pa++)
-                    ntri += Mark[Ai[pa]];
+                    if (Ai[pa] > k) hits += Mark[Ai[pa]];
+                tc_partial_add(&ntri, &spill, hits);
             }
-            
+
             // Clear marks for next iteration
             for (UINT_t p = j_start; p < j_end; p++)
                 Mark[Ai[p]] = false;
         }
-        
+
         free(Mark);
-        return ntri / 6;
+        tc_u128_add(&spill, ntri);
+        return tc_u128_to_uint(spill, "triangle count");
     }
-    
+
     // For larger graphs, use forward hash algorithm with degree ordering
     // Reorder vertices by degree (highest first) for better cache locality
     GRAPH_TYPE *ordered_graph = reorder_graph_by_degree(graph, REORDER_HIGHEST_DEGREE_FIRST);
-    
-    const UINT_t* restrict Ap = ordered_graph->rowPtr;
-    const UINT_t* restrict Ai = ordered_graph->colInd;
-
-    // Allocate data structures for forward algorithm
-    bool* restrict Hash = (bool*)calloc(n, sizeof(bool));
-    assert_malloc(Hash);
-
-    UINT_t* restrict Size = (UINT_t*)calloc(n, sizeof(UINT_t));
-    assert_malloc(Size);
-    
-    UINT_t* restrict A = (UINT_t*)calloc(m, sizeof(UINT_t));
-    assert_malloc(A);
-
-    UINT_t count = 0;
-
-    // Forward algorithm: process vertices in order
-    for (UINT_t s = 0; s < n; s++) {
-        const UINT_t s_start = Ap[s];
-        const UINT_t s_end = Ap[s + 1];
-        
-        // Process each neighbor of s
-        for (UINT_t i = s_start; i < s_end; i++) {
-            const UINT_t t = Ai[i];
-            
-            // Only process edge (s,t) where s < t to avoid double counting
-            if (s < t) {
-                // Compute intersection of forward neighbors using hash table
-                const UINT_t s_size = Size[s];
-                const UINT_t t_size = Size[t];
-                
-                // Optimize for empty lists
-                if (s_size > 0 && t_size > 0) {
-                    // Hash the smaller list for better performance
-                    if (s_size <= t_size) {
-                        // Hash s's forward neighbors
-                        const UINT_t s_base = Ap[s];
-                        for (UINT_t j = 0; j < s_size; j++)
-                            Hash[A[s_base + j]] = true;
-                        
-                        // Check t's forward neighbors against hash
-                        const UINT_t t_base = Ap[t];
-                        for (UINT_t j = 0; j < t_size; j++) {
-                            count += Hash[A[t_base + j]];
-                        }
-                        
-                        // Clear hash table
-                        for (UINT_t j = 0; j < s_size; j++)
-                            Hash[A[s_base + j]] = false;
-                    } else {
-                        // Hash t's forward neighbors
-                        const UINT_t t_base = Ap[t];
-                        for (UINT_t j = 0; j < t_size; j++)
-                            Hash[A[t_base + j]] = true;
-                        
-                        // Check s's forward neighbors against hash
-                        const UINT_t s_base = Ap[s];
-                        for (UINT_t j = 0; j < s_size; j++) {
-                            count += Hash[A[s_base + j]];
-                        }
-                        
-                        // Clear hash table
-                        for (UINT_t j = 0; j < t_size; j++)
-                            Hash[A[t_base + j]] = false;
-                    }
+    tc_sort_rows(ordered_graph);
+
+    const tc_u128_t count = tc_forward_parallel(ordered_graph);
+
+    free_graph(ordered_graph);
+
+    return tc_u128_to_uint(count, "triangle count");
+#endif
+}
+
+// Deterministic audit path, not a fast one: computes per-edge and per-vertex
+// triangle counts on the input graph (no reordering, so indices refer to the
+// caller's graph) and returns the total. Built with -DTC_DETERMINISTIC,
+// tc_fast routes here.
+//
+// Results do not depend on the thread count or schedule because every output
+// slot has exactly one writer and all sums are exact integer additions with
+// overflow checks; a count that cannot be represented aborts rather than
+// wrapping.
+//
+// edge_tri[p] receives the number of triangles containing the edge stored at
+// colInd[p]; vertex_tri[v] the number of triangles containing v. Both use
+// UINT_t like the return value. Either may be NULL. Adjacency lists need not
+// be sorted.
+UINT_t tc_fast_deterministic(const GRAPH_TYPE *graph, UINT_t *vertex_tri, UINT_t *edge_tri) {
+    const UINT_t n = graph->numVertices;
+    const UINT_t m = graph->numEdges;
+    const UINT_t* restrict Ap = graph->rowPtr;
+    const UINT_t* restrict Ai = graph->colInd;
+
+    UINT_t* restrict support = edge_tri;
+    if (!support) {
+        support = (UINT_t*)calloc(m > 0 ? m : 1, sizeof(UINT_t));
+        assert_malloc(support);
+    }
+
+    const int nthreads = tc_num_threads();
+    tc_u128_t* restrict partials = (tc_u128_t*)calloc(nthreads, sizeof(tc_u128_t));
+    assert_malloc(partials);
+
+    // Support of each undirected edge {v,u}, v < u, is computed once by the
+    // thread handling v and written to both the (v,u) and (u,v) slots
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        bool* restrict Mark = (bool*)calloc(n, sizeof(bool));
+        assert_malloc(Mark);
+
+        uint64_t count = 0;
+        tc_u128_t spill = {0, 0};
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (UINT_t v = 0; v < n; v++) {
+            const UINT_t v_start = Ap[v];
+            const UINT_t v_end = Ap[v + 1];
+
+            for (UINT_t p = v_start; p < v_end; p++)
+                Mark[Ai[p]] = true;
+
+            for (UINT_t p = v_start; p < v_end; p++) {
+                const UINT_t u = Ai[p];
+                if (u <= v) continue;
+
+                // Scan N(u) once: count common neighbors and find the reverse slot
+                UINT_t s = 0;
+                UINT_t rev = m;
+                for (UINT_t q = Ap[u]; q < Ap[u + 1]; q++) {
+                    const UINT_t x = Ai[q];
+                    s += Mark[x];
+                    if (x == v) rev = q;
                 }
-                
-                // Add s to t's forward adjacency list
-                A[Ap[t] + Size[t]] = s;
-                Size[t]++;
+
+                support[p] = s;
+                if (rev < m) support[rev] = s;
+                tc_partial_add(&count, &spill, s);
             }
+
+            for (UINT_t p = v_start; p < v_end; p++)
+                Mark[Ai[p]] = false;
         }
+
+        tc_u128_add(&spill, count);
+        partials[tc_thread_id()] = spill;
+        free(Mark);
     }
 
-    // Cleanup
-    free(A);
-    free(Size);
-    free(Hash);
-    free_graph(ordered_graph);
-    
-    return count;
+    // Per-vertex counts: each triangle at v is seen from both of its edges at v
+    if (vertex_tri) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+        for (UINT_t v = 0; v < n; v++) {
+            uint64_t sum = 0;
+            tc_u128_t spill = {0, 0};
+            for (UINT_t p = Ap[v]; p < Ap[v + 1]; p++)
+                tc_partial_add(&sum, &spill, support[p]);
+            tc_u128_add(&spill, sum);
+            spill.lo = (spill.lo >> 1) | (spill.hi << 63);
+            spill.hi >>= 1;
+            vertex_tri[v] = tc_u128_to_uint(spill, "per-vertex triangle count");
+        }
+    }
+
+    // Each triangle contributes the support of its three edges
+    tc_u128_t total = {0, 0};
+    for (int i = 0; i < nthreads; i++)
+        tc_u128_add_u128(&total, partials[i]);
+
+    free(partials);
+    if (support != edge_tri) free(support);
+
+    return tc_u128_to_uint(tc_u128_div3(total), "triangle count");
 }